@@ -7,6 +7,8 @@
 #define BT_TX_MSG_COUNT			8
 #define BT_TX_THREAD_STACKSIZE	1024
 #define BT_TX_THREAD_PRIORITY	5
+#define BT_BULK_TX_THREAD_STACKSIZE	1024
+#define BT_BULK_TX_THREAD_PRIORITY	7
 
 typedef enum {APP_BT_EVT_CONNECTED, APP_BT_EVT_DISCONNECTED, APP_BT_EVT_NUS_DATA_RECEIVED} app_bt_evt_type_t;
 
@@ -22,4 +24,14 @@ int app_bt_init(app_bt_callback_t callback);
 
 int app_bt_send(uint8_t *data_ptr, uint16_t length);
 
+int app_bt_send_timeout(uint8_t *data_ptr, uint16_t length, k_timeout_t timeout);
+
+/**
+ * @brief Submit work that sends bulk data with app_bt_send_timeout().
+ *
+ * Runs on a dedicated work queue, so that waiting for room in the NUS TX queue doesn't hold up
+ * the system work queue.
+ */
+int app_bt_bulk_work_submit(struct k_work *work);
+
 #endif
@@ -0,0 +1,78 @@
+#ifndef __APP_LOG_H
+#define __APP_LOG_H
+
+#include <zephyr.h>
+#include <zephyr/logging/log.h>
+
+/**
+ * @brief Token bucket limiting the log rate of a module.
+ *
+ * Tokens are counted in thousandths, so that rates below one message per second work.
+ */
+struct app_log_bucket {
+	uint32_t rate_per_sec;
+	uint32_t burst;
+	uint32_t milli_tokens;
+	uint32_t last_refill_ms;
+	uint32_t suppressed;
+};
+
+/**
+ * @brief Define the rate limit of the module. Must follow LOG_MODULE_REGISTER().
+ *
+ * @param _rate_per_sec Sustained number of messages per second.
+ * @param _burst        Number of messages that can be logged back to back.
+ */
+#define APP_LOG_BUCKET_DEFINE(_rate_per_sec, _burst)				\
+	static struct app_log_bucket app_log_bucket = {				\
+		.rate_per_sec = (_rate_per_sec),					\
+		.burst = (_burst),							\
+		.milli_tokens = (_burst) * 1000,					\
+	}
+
+#if defined(CONFIG_APP_LOG_RATE_LIMIT)
+
+/**
+ * @brief Take a token from the bucket.
+ *
+ * @return Number of messages suppressed since the last token was taken plus one, or 0 if the
+ *         bucket is empty and the message should be dropped.
+ */
+uint32_t app_log_token_take(struct app_log_bucket *bucket);
+
+/*
+ * Messages filtered out by the module log level never take a token, or they would use up the
+ * bucket and get reported as suppressed.
+ */
+#define APP_LOG_RATELIMITED(_level, _log_macro, ...)				\
+	do {									\
+		if (!Z_LOG_CONST_LEVEL_CHECK(_level)) {				\
+			break;							\
+		}								\
+		uint32_t _taken = app_log_token_take(&app_log_bucket);		\
+		if (_taken > 1) {						\
+			LOG_WRN("%u messages suppressed", _taken - 1);		\
+		}								\
+		if (_taken > 0) {						\
+			_log_macro(__VA_ARGS__);				\
+		}								\
+	} while (0)
+
+#else
+
+#define APP_LOG_RATELIMITED(_level, _log_macro, ...)				\
+	do {									\
+		(void)app_log_bucket;						\
+		_log_macro(__VA_ARGS__);					\
+	} while (0)
+
+#endif
+
+/* Rate limited variants of the log macros, for hot paths. Errors are never rate limited. */
+#define APP_LOG_WRN(...) APP_LOG_RATELIMITED(LOG_LEVEL_WRN, LOG_WRN, __VA_ARGS__)
+#define APP_LOG_INF(...) APP_LOG_RATELIMITED(LOG_LEVEL_INF, LOG_INF, __VA_ARGS__)
+#define APP_LOG_DBG(...) APP_LOG_RATELIMITED(LOG_LEVEL_DBG, LOG_DBG, __VA_ARGS__)
+
+int app_log_backend_ble_enable(bool enable);
+
+#endif
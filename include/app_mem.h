@@ -0,0 +1,64 @@
+#ifndef __APP_MEM_H
+#define __APP_MEM_H
+
+#include <zephyr.h>
+#include <zephyr/sys/slist.h>
+
+#define APP_MEM_REPORT_LINE_LEN_MAX	64
+#define APP_MEM_MAX_THREADS			16
+#define APP_MEM_MAX_POOLS			16
+
+/** @brief High-water mark of a static buffer, queue or pool. */
+struct app_mem_watermark {
+	sys_snode_t node;
+	const char *name;
+	const char *unit;
+	uint32_t size;
+	uint32_t max_used;
+	uint32_t overflows;
+	bool registered;
+};
+
+#define APP_MEM_WATERMARK_INIT(_name, _size, _unit) { .name = (_name), .unit = (_unit), .size = (_size) }
+
+typedef void (*app_mem_report_cb_t)(const char *line);
+
+#if defined(CONFIG_APP_MEM_BUDGET)
+
+/**
+ * @brief Record the current usage of a buffer. The buffer shows up in the report from the first call.
+ */
+void app_mem_watermark_update(struct app_mem_watermark *wm, uint32_t used);
+
+/**
+ * @brief Record that data was dropped or truncated because the buffer was full.
+ */
+void app_mem_watermark_overflow(struct app_mem_watermark *wm);
+
+/**
+ * @brief Sample the free buffer count of the net_buf pools (Bluetooth buffers), to track their
+ *        low-water marks. Call where buffers are likely to be in use, like right after sending.
+ */
+void app_mem_pool_sample(void);
+
+/**
+ * @brief Produce the memory budget report, one line at a time.
+ *
+ * Lists stack usage of every thread, followed by the buffer watermarks, the net_buf pool
+ * watermarks and log buffer usage, if enabled. Must not be called from a context that can't block, as @p cb may.
+ */
+void app_mem_report(app_mem_report_cb_t cb);
+
+#else
+
+static inline void app_mem_watermark_update(struct app_mem_watermark *wm, uint32_t used) {}
+
+static inline void app_mem_watermark_overflow(struct app_mem_watermark *wm) {}
+
+static inline void app_mem_pool_sample(void) {}
+
+static inline void app_mem_report(app_mem_report_cb_t cb) {}
+
+#endif
+
+#endif
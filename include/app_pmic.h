@@ -9,8 +9,28 @@ typedef struct {
 	int type;
 } app_pmic_evt_t;
 
+typedef enum {APP_PMIC_TEMP_ZONE_UNKNOWN, APP_PMIC_TEMP_ZONE_COLD, APP_PMIC_TEMP_ZONE_COOL, 
+			  APP_PMIC_TEMP_ZONE_NORMAL, APP_PMIC_TEMP_ZONE_WARM, APP_PMIC_TEMP_ZONE_HOT} app_pmic_temp_zone_t;
+
+/** @brief Charge profile, applied as-is in the normal temperature zone. */
+typedef struct {
+	uint16_t charge_current_ma;
+	uint16_t term_voltage_mv;
+} app_pmic_charge_profile_t;
+
+/** @brief Charger settings currently in effect, as chosen by the charge profile engine. */
+typedef struct {
+	app_pmic_temp_zone_t temp_zone;
+	int16_t temperature;
+	uint16_t vbus_limit_ma;
+	uint16_t charge_current_ma; /** 0 when charging is suspended. */
+	uint16_t term_voltage_mv;
+} app_pmic_charge_status_t;
+
 extern const char *pmic_state_name_strings[];
 
+extern const char *pmic_temp_zone_name_strings[];
+
 typedef void (*app_pmic_callback_t)(app_pmic_evt_t *evt);
 
 int app_pmic_init(app_pmic_callback_t callback);
@@ -21,4 +41,16 @@ int app_pmic_buck_out_enable(bool enable);
 
 int app_pmic_set_buck_out_voltage(int decivolt);
 
-#endif
\ No newline at end of file
+/**
+ * @brief Apply a new charge profile and store it in flash.
+ *
+ * @return 0 on success, -EINVAL if the profile is not supported by the charger, or -EIO if the
+ *         profile is applied but could not be stored.
+ */
+int app_pmic_set_charge_profile(const app_pmic_charge_profile_t *profile);
+
+void app_pmic_get_charge_profile(app_pmic_charge_profile_t *profile);
+
+void app_pmic_get_charge_status(app_pmic_charge_status_t *status);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __APP_TRACE_H
+#define __APP_TRACE_H
+
+#include <zephyr.h>
+#include <npmx_core.h>
+
+#define APP_TRACE_MAGIC					0x5254504E	/* "NPTR" */
+#define APP_TRACE_VERSION				1
+#define APP_TRACE_REPLAY_THREAD_STACKSIZE	1024
+#define APP_TRACE_REPLAY_THREAD_PRIORITY	6
+
+/** @brief Kind of a trace record. Callback records are followed by the reads done by that callback. */
+typedef enum {APP_TRACE_SRC_VBUSIN, APP_TRACE_SRC_ADC, APP_TRACE_SRC_CHARGER_STATUS, APP_TRACE_SRC_CHARGER_BATTERY, 
+			  APP_TRACE_SRC_COUNT,
+			  APP_TRACE_READ_VBAT = 0x10, APP_TRACE_READ_BAT_TEMP, APP_TRACE_READ_CHARGER_STATUS, 
+			  APP_TRACE_READ_VBUS_CC} app_trace_kind_t;
+
+/** @brief Trace file header, followed by record_count records. All fields are little endian. */
+typedef struct __packed {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t record_size;
+	uint16_t record_count;
+} app_trace_header_t;
+
+typedef struct __packed {
+	uint32_t timestamp;	/** Time since the start of the capture [ms]. */
+	uint8_t kind;		/** @ref app_trace_kind_t */
+	uint8_t mask;		/** Event mask, for callback records. */
+	uint16_t value;		/** Callback type for callback records, the reading otherwise. */
+} app_trace_record_t;
+
+/**
+ * @brief Header of a "Dtr" dump packet. The dump shares the NUS characteristic with everything else,
+ *        so the trace file is sent in frames that the host picks out of the received data and
+ *        joins in sequence order. See scripts/trace_extract.py.
+ */
+typedef struct __packed {
+	uint8_t prefix[3];	/** APP_TRACE_FRAME_PREFIX */
+	uint16_t seq;		/** Frame number, starting at 0. Little endian. */
+	uint8_t length;		/** Number of trace file bytes following the header. */
+} app_trace_frame_header_t;
+
+#define APP_TRACE_FRAME_PREFIX			"TRC"
+
+typedef void (*app_trace_handler_t)(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8_t mask);
+
+#if defined(CONFIG_APP_EVENT_TRACE_RECORD)
+
+void app_trace_record_callback(app_trace_kind_t source, npmx_callback_type_t type, uint8_t mask);
+
+void app_trace_record_read(app_trace_kind_t kind, uint16_t value);
+
+int app_trace_record_start(void);
+
+int app_trace_dump(void);
+
+#else
+
+static inline void app_trace_record_callback(app_trace_kind_t source, npmx_callback_type_t type, uint8_t mask) {}
+
+static inline void app_trace_record_read(app_trace_kind_t kind, uint16_t value) {}
+
+static inline int app_trace_record_start(void) { return -ENOTSUP; }
+
+static inline int app_trace_dump(void) { return -ENOTSUP; }
+
+#endif
+
+#if defined(CONFIG_APP_EVENT_TRACE_REPLAY)
+
+int app_trace_replay_start(const app_trace_handler_t handlers[APP_TRACE_SRC_COUNT]);
+
+int app_trace_replay_read(app_trace_kind_t kind, uint16_t *value);
+
+void app_trace_notification(int err);
+
+#else
+
+static inline void app_trace_notification(int err) {}
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2022 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Build time RAM budget report.
+
+Lists the statically allocated RAM of thread stacks, kernel message queue
+buffers and application buffers (m_ prefixed symbols) in the final ELF, so
+they can be compared against the run time high-water marks from the "Mem"
+command.
+"""
+
+import argparse
+import subprocess
+import sys
+
+RAM_SYMBOL_TYPES = 'bBdD'
+
+CATEGORIES = [
+    ('Thread stacks', lambda name: 'stack' in name and 'stack_info' not in name),
+    ('Message queue buffers', lambda name: name.startswith('_k_fifo_buf_')),
+    ('Application buffers', lambda name: name.startswith('m_')),
+]
+
+
+def read_symbols(nm, elf):
+    output = subprocess.run([nm, '--print-size', '--size-sort', elf],
+                            check=True, capture_output=True, text=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in RAM_SYMBOL_TYPES:
+            continue
+        yield fields[3], int(fields[1], 16)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--nm', required=True, help='nm executable of the toolchain')
+    parser.add_argument('--elf', required=True, help='ELF file to analyze')
+    parser.add_argument('--output', help='File to write the report to, in addition to stdout')
+    args = parser.parse_args()
+
+    symbols = list(read_symbols(args.nm, args.elf))
+    total = sum(size for _, size in symbols)
+
+    lines = ['RAM budget (static allocations)']
+    for title, match in CATEGORIES:
+        entries = sorted(((name, size) for name, size in symbols if match(name)),
+                         key=lambda entry: entry[1], reverse=True)
+        if not entries:
+            continue
+        subtotal = sum(size for _, size in entries)
+        lines.append(f'  {title}: {subtotal} B')
+        lines.extend(f'    {name:<40} {size:>6} B' for name, size in entries)
+        # A symbol is only counted in the first category it matches
+        symbols = [(name, size) for name, size in symbols if not match(name)]
+    lines.append(f'  Other: {sum(size for _, size in symbols)} B')
+    lines.append(f'  Total: {total} B')
+
+    report = '\n'.join(lines) + '\n'
+    sys.stdout.write(report)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(report)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2022 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Extract an event trace from a "Dtr" capture.
+
+The capture is everything received over NUS while the trace was dumped, in
+the order it was received. Dump frames are picked out of it and joined in
+sequence order, and any other packets (command replies, PMIC event
+notifications, log lines) in between are skipped. The result is checked
+against the trace header and written as a trace file for
+CONFIG_APP_EVENT_TRACE_REPLAY_FILE.
+"""
+
+import argparse
+import struct
+import sys
+
+FRAME_PREFIX = b'TRC'
+FRAME_HEADER = struct.Struct('<3sHB')
+FRAME_PAYLOAD_MAX = 128 - FRAME_HEADER.size
+
+TRACE_MAGIC = 0x5254504E
+TRACE_VERSION = 1
+TRACE_HEADER = struct.Struct('<IBBH')
+
+
+def extract_frames(capture):
+    """Yield the payloads of consecutive dump frames found in the capture."""
+    pos = 0
+    seq = 0
+    while True:
+        pos = capture.find(FRAME_PREFIX, pos)
+        if pos < 0 or pos + FRAME_HEADER.size > len(capture):
+            return
+        _, frame_seq, length = FRAME_HEADER.unpack_from(capture, pos)
+        end = pos + FRAME_HEADER.size + length
+        if frame_seq != seq or length == 0 or length > FRAME_PAYLOAD_MAX or end > len(capture):
+            # Not a frame, "TRC" showed up in some other packet
+            pos += 1
+            continue
+        yield capture[pos + FRAME_HEADER.size:end]
+        seq += 1
+        pos = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('capture', help='Data received over NUS while dumping the trace')
+    parser.add_argument('output', help='Trace file to write')
+    args = parser.parse_args()
+
+    with open(args.capture, 'rb') as f:
+        capture = f.read()
+
+    trace = bytearray()
+    for payload in extract_frames(capture):
+        trace += payload
+        if len(trace) >= TRACE_HEADER.size:
+            magic, version, record_size, record_count = TRACE_HEADER.unpack_from(trace)
+            if magic != TRACE_MAGIC or version != TRACE_VERSION:
+                sys.exit('Not an event trace, or unsupported trace version')
+            if len(trace) >= TRACE_HEADER.size + record_size * record_count:
+                break
+    else:
+        sys.exit(f'Incomplete trace, only {len(trace)} bytes found')
+
+    size = TRACE_HEADER.size + record_size * record_count
+    with open(args.output, 'wb') as f:
+        f.write(trace[:size])
+    print(f'{record_count} records written to {args.output}')
+
+
+if __name__ == '__main__':
+    main()
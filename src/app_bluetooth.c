@@ -1,4 +1,6 @@
 #include <app_bluetooth.h>
+#include <app_log.h>
+#include <app_mem.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/conn.h>
@@ -11,6 +13,7 @@
 
 #define LOG_MODULE_NAME app_bt
 LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+APP_LOG_BUCKET_DEFINE(CONFIG_APP_LOG_RATE_PER_SEC, CONFIG_APP_LOG_RATE_BURST);
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN	(sizeof(DEVICE_NAME) - 1)
@@ -36,6 +39,11 @@ struct nus_message_type_t {
 
 K_MSGQ_DEFINE(m_msgq_nus_tx, sizeof(struct nus_message_type_t), BT_TX_MSG_COUNT, 4);
 
+K_THREAD_STACK_DEFINE(m_bulk_tx_stack, BT_BULK_TX_THREAD_STACKSIZE);
+static struct k_work_q m_bulk_tx_work_q;
+
+static struct app_mem_watermark m_msgq_nus_tx_wm = APP_MEM_WATERMARK_INIT("NUS TX queue", BT_TX_MSG_COUNT, "msgs");
+
 static void bt_exchange_func(struct bt_conn *conn, uint8_t att_err,
 			  struct bt_gatt_exchange_params *params)
 {
@@ -97,7 +105,7 @@ static void bt_receive_cb(struct bt_conn *conn, const uint8_t *const data, uint1
 {
 	static app_bt_evt_t receive_event;
 
-	LOG_INF("Bluetooth data received");
+	APP_LOG_INF("Bluetooth data received");
 
 	receive_event.type = APP_BT_EVT_NUS_DATA_RECEIVED;
 	receive_event.buf = data;
@@ -118,6 +126,12 @@ int app_bt_init(app_bt_callback_t callback)
 
 	m_app_callback = callback;
 
+	app_mem_watermark_update(&m_msgq_nus_tx_wm, 0);
+
+	struct k_work_queue_config bulk_tx_config = {.name = "bt_bulk_tx"};
+	k_work_queue_start(&m_bulk_tx_work_q, m_bulk_tx_stack, K_THREAD_STACK_SIZEOF(m_bulk_tx_stack),
+					   BT_BULK_TX_THREAD_PRIORITY, &bulk_tx_config);
+
 	LOG_INF("Bluetooth initialized");
 
 	ret = bt_nus_init(&nus_cb);
@@ -136,19 +150,34 @@ int app_bt_init(app_bt_callback_t callback)
 }
 
 int app_bt_send(uint8_t *data_ptr, uint16_t length)
+{
+	return app_bt_send_timeout(data_ptr, length, K_NO_WAIT);
+}
+
+int app_bt_send_timeout(uint8_t *data_ptr, uint16_t length, k_timeout_t timeout)
 {
 	struct nus_message_type_t new_message;
 
+	if (length > NUS_STRING_LEN_MAX) return -EINVAL;
+
 	new_message.length = length;
 	memcpy(new_message.buf, data_ptr, length);
 
-	if (k_msgq_put(&m_msgq_nus_tx, (void *)&new_message, K_NO_WAIT) != 0) {
+	if (k_msgq_put(&m_msgq_nus_tx, (void *)&new_message, timeout) != 0) {
+		app_mem_watermark_overflow(&m_msgq_nus_tx_wm);
 		return -ENOMEM;
 	}
 
+	app_mem_watermark_update(&m_msgq_nus_tx_wm, k_msgq_num_used_get(&m_msgq_nus_tx));
+
 	return 0;
 }
 
+int app_bt_bulk_work_submit(struct k_work *work)
+{
+	return k_work_submit_to_queue(&m_bulk_tx_work_q, work);
+}
+
 static void bt_tx_thread_func(void)
 {
 	struct nus_message_type_t new_message;
@@ -157,6 +186,9 @@ static void bt_tx_thread_func(void)
 		k_msgq_get(&m_msgq_nus_tx, (void *)&new_message, K_FOREVER);
 
 		bt_nus_send(0, new_message.buf, new_message.length);
+
+		/* Buffers are most likely to be in use right after sending. */
+		app_mem_pool_sample();
 	}
 }
 
@@ -0,0 +1,152 @@
+#include <app_log.h>
+#include <app_bluetooth.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <stdio.h>
+
+#if defined(CONFIG_APP_LOG_RATE_LIMIT)
+
+static struct k_spinlock m_bucket_lock;
+
+uint32_t app_log_token_take(struct app_log_bucket *bucket)
+{
+	uint32_t taken = 0;
+	uint32_t now_ms = k_uptime_get_32();
+	k_spinlock_key_t key = k_spin_lock(&m_bucket_lock);
+
+	/* Refill at rate_per_sec tokens per second, up to the burst size. The elapsed time is capped at
+	 * what refills an empty bucket, so the product can't overflow however long the module was idle. */
+	uint32_t elapsed_ms = MIN(now_ms - bucket->last_refill_ms, bucket->burst * 1000 / bucket->rate_per_sec);
+
+	bucket->milli_tokens = MIN(bucket->milli_tokens + elapsed_ms * bucket->rate_per_sec,
+							   bucket->burst * 1000);
+	bucket->last_refill_ms = now_ms;
+
+	if (bucket->milli_tokens >= 1000) {
+		bucket->milli_tokens -= 1000;
+		taken = bucket->suppressed + 1;
+		bucket->suppressed = 0;
+	} else {
+		bucket->suppressed++;
+	}
+
+	k_spin_unlock(&m_bucket_lock, key);
+
+	return taken;
+}
+
+#endif /* CONFIG_APP_LOG_RATE_LIMIT */
+
+#if defined(CONFIG_APP_LOG_BACKEND_BLE)
+
+/* Every packet sent by this backend starts with this prefix, so the client can tell log lines
+ * apart from command replies on the same NUS characteristic. */
+#define BLE_LOG_PREFIX		"LOG "
+#define BLE_LOG_PREFIX_LEN	(sizeof(BLE_LOG_PREFIX) - 1)
+
+/* Log sources that must not be forwarded, since sending over NUS can make them log again. */
+#define BLE_LOG_SOURCE_EXCLUDED(name) (strncmp((name), "bt_", 3) == 0)
+
+static uint8_t m_ble_output_buf[16];
+static uint8_t m_ble_line[NUS_STRING_LEN_MAX] = BLE_LOG_PREFIX;
+static size_t m_ble_line_len = BLE_LOG_PREFIX_LEN;
+static uint32_t m_ble_lines_lost;
+
+static void ble_line_flush(void)
+{
+	if (m_ble_line_len == BLE_LOG_PREFIX_LEN) return;
+
+	/* Never block logging on Bluetooth. Lines are sent whole, so losing one doesn't affect the rest. */
+	if (app_bt_send(m_ble_line, m_ble_line_len) < 0) {
+		m_ble_lines_lost++;
+	}
+	m_ble_line_len = BLE_LOG_PREFIX_LEN;
+}
+
+/**
+ * @brief Log output function, collecting formatted log text into one NUS packet per line.
+ *
+ * Lines too long for a packet are split over several packets.
+ */
+static int ble_output_func(uint8_t *data, size_t length, void *ctx)
+{
+	for (size_t i = 0; i < length; i++) {
+		if (data[i] == '\r') continue;
+
+		if (data[i] == '\n') {
+			ble_line_flush();
+			continue;
+		}
+
+		if (m_ble_line_len == sizeof(m_ble_line)) ble_line_flush();
+		m_ble_line[m_ble_line_len++] = data[i];
+	}
+
+	return length;
+}
+
+LOG_OUTPUT_DEFINE(m_log_output_ble, ble_output_func, m_ble_output_buf, sizeof(m_ble_output_buf));
+
+static void ble_backend_process(const struct log_backend *const backend, union log_msg2_generic *msg)
+{
+	const void *source = log_msg2_get_source(&msg->log);
+
+	if (source != NULL) {
+		const char *name = log_source_name_get(log_msg2_get_domain(&msg->log),
+											   log_const_source_id(source));
+		if (name != NULL && BLE_LOG_SOURCE_EXCLUDED(name)) return;
+	}
+
+	if (m_ble_lines_lost > 0) {
+		uint32_t lost = m_ble_lines_lost;
+		m_ble_lines_lost = 0;
+		m_ble_line_len += snprintf((char *)&m_ble_line[BLE_LOG_PREFIX_LEN], sizeof(m_ble_line) - BLE_LOG_PREFIX_LEN,
+								   "--- %u lines lost ---", lost);
+		ble_line_flush();
+	}
+
+	/* Always text, even when the other backends use dictionary output: the client reads this
+	 * stream directly, and text lines can be lost without corrupting the ones that follow. */
+	log_output_msg2_process(&m_log_output_ble, &msg->log, LOG_OUTPUT_FLAG_LEVEL);
+}
+
+static void ble_backend_panic(const struct log_backend *const backend)
+{
+	/* Bluetooth can't be used from panic context, stop forwarding. */
+	log_backend_disable(backend);
+}
+
+static void ble_backend_dropped(const struct log_backend *const backend, uint32_t cnt)
+{
+	log_output_dropped_process(&m_log_output_ble, cnt);
+}
+
+static const struct log_backend_api m_ble_backend_api = {
+	.process = ble_backend_process,
+	.panic = ble_backend_panic,
+	.dropped = ble_backend_dropped,
+};
+
+/* Not started automatically, forwarding is turned on over NUS when a client wants it. */
+LOG_BACKEND_DEFINE(m_log_backend_ble, m_ble_backend_api, false);
+
+int app_log_backend_ble_enable(bool enable)
+{
+	if (enable) {
+		log_backend_enable(&m_log_backend_ble, NULL, CONFIG_LOG_MAX_LEVEL);
+	} else {
+		log_backend_disable(&m_log_backend_ble);
+	}
+
+	return 0;
+}
+
+#else
+
+int app_log_backend_ble_enable(bool enable)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_APP_LOG_BACKEND_BLE */
@@ -0,0 +1,163 @@
+#include <app_mem.h>
+#include <stdio.h>
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+#include <zephyr/net/buf.h>
+#endif
+
+#if defined(CONFIG_LOG_MEM_UTILIZATION)
+#include <zephyr/logging/log_ctrl.h>
+#endif
+
+#if defined(CONFIG_APP_MEM_BUDGET)
+
+struct thread_stack_info {
+	const char *name;
+	size_t size;
+	size_t unused;
+};
+
+static sys_slist_t m_watermarks = SYS_SLIST_STATIC_INIT(&m_watermarks);
+static struct k_spinlock m_watermark_lock;
+
+/* Collected first and formatted afterwards, so the report callback never runs while threads are walked. */
+static struct thread_stack_info m_threads[APP_MEM_MAX_THREADS];
+static int m_thread_count;
+static int m_threads_skipped;
+K_MUTEX_DEFINE(m_report_mutex);
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+/* Lowest free buffer count seen per pool, in pool section order. */
+static uint16_t m_pool_min_avail[APP_MEM_MAX_POOLS];
+static bool m_pool_sampled;
+#endif
+
+static void watermark_register(struct app_mem_watermark *wm)
+{
+	if (!wm->registered) {
+		wm->registered = true;
+		sys_slist_append(&m_watermarks, &wm->node);
+	}
+}
+
+void app_mem_watermark_update(struct app_mem_watermark *wm, uint32_t used)
+{
+	k_spinlock_key_t key = k_spin_lock(&m_watermark_lock);
+
+	watermark_register(wm);
+	if (used > wm->max_used) wm->max_used = used;
+
+	k_spin_unlock(&m_watermark_lock, key);
+}
+
+void app_mem_watermark_overflow(struct app_mem_watermark *wm)
+{
+	k_spinlock_key_t key = k_spin_lock(&m_watermark_lock);
+
+	watermark_register(wm);
+	wm->overflows++;
+
+	k_spin_unlock(&m_watermark_lock, key);
+}
+
+void app_mem_pool_sample(void)
+{
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	int i = 0;
+	k_spinlock_key_t key = k_spin_lock(&m_watermark_lock);
+
+	if (!m_pool_sampled) {
+		for (int j = 0; j < APP_MEM_MAX_POOLS; j++) m_pool_min_avail[j] = UINT16_MAX;
+		m_pool_sampled = true;
+	}
+
+	STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+		if (i >= APP_MEM_MAX_POOLS) break;
+		m_pool_min_avail[i] = MIN(m_pool_min_avail[i], (uint16_t)atomic_get(&pool->avail_count));
+		i++;
+	}
+
+	k_spin_unlock(&m_watermark_lock, key);
+#endif
+}
+
+static void thread_stack_collect(const struct k_thread *thread, void *user_data)
+{
+	struct thread_stack_info *info;
+	size_t unused;
+
+	if (m_thread_count >= APP_MEM_MAX_THREADS) {
+		m_threads_skipped++;
+		return;
+	}
+
+	/* Threads without stack info, or running on a user provided stack we can't scan, are left out. */
+	if (k_thread_stack_space_get(thread, &unused) != 0) return;
+
+	info = &m_threads[m_thread_count++];
+	info->name = k_thread_name_get((k_tid_t)thread);
+	info->size = thread->stack_info.size;
+	info->unused = unused;
+}
+
+void app_mem_report(app_mem_report_cb_t cb)
+{
+	char line[APP_MEM_REPORT_LINE_LEN_MAX];
+	struct app_mem_watermark *wm;
+
+	k_mutex_lock(&m_report_mutex, K_FOREVER);
+
+	m_thread_count = 0;
+	m_threads_skipped = 0;
+	/* Scanning the stacks takes a while, don't do it with interrupts locked. */
+	k_thread_foreach_unlocked(thread_stack_collect, NULL);
+
+	for (int i = 0; i < m_thread_count; i++) {
+		snprintf(line, sizeof(line), "Stack %s: %u/%u B",
+				 m_threads[i].name ? m_threads[i].name : "?",
+				 (unsigned int)(m_threads[i].size - m_threads[i].unused), (unsigned int)m_threads[i].size);
+		cb(line);
+	}
+	if (m_threads_skipped > 0) {
+		snprintf(line, sizeof(line), "%d threads not listed", m_threads_skipped);
+		cb(line);
+	}
+
+	/* Watermarks are only ever appended, so the list can be walked without holding the lock. */
+	SYS_SLIST_FOR_EACH_CONTAINER(&m_watermarks, wm, node) {
+		snprintf(line, sizeof(line), "%s: %u/%u %s, %u overflows", wm->name, wm->max_used,
+				 wm->size, wm->unit, wm->overflows);
+		cb(line);
+	}
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	int pool_index = 0;
+
+	app_mem_pool_sample();
+
+	STRUCT_SECTION_FOREACH(net_buf_pool, pool) {
+		if (pool_index >= APP_MEM_MAX_POOLS) {
+			cb("More pools not listed");
+			break;
+		}
+		snprintf(line, sizeof(line), "Pool %s: %u/%u bufs", pool->name ? pool->name : "?",
+				 pool->pool_size - m_pool_min_avail[pool_index], pool->pool_size);
+		cb(line);
+		pool_index++;
+	}
+#endif
+
+#if defined(CONFIG_LOG_MEM_UTILIZATION)
+	uint32_t log_buf_size, log_usage, log_max_usage;
+
+	if (log_mem_get_usage(&log_buf_size, &log_usage) == 0 &&
+		log_mem_get_max_usage(&log_max_usage) == 0) {
+		snprintf(line, sizeof(line), "Log buffer: %u/%u B", log_max_usage, log_buf_size);
+		cb(line);
+	}
+#endif
+
+	k_mutex_unlock(&m_report_mutex);
+}
+
+#endif /* CONFIG_APP_MEM_BUDGET */
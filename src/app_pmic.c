@@ -1,15 +1,20 @@
 
 #include <app_pmic.h>
+#include <app_trace.h>
+#include <app_log.h>
 #include <npmx_driver.h>
 #include <npmx_gpio.h>
 #include <npmx_core.h>
 #include <npmx_charger.h>
 #include <npmx_adc.h>
 #include <npmx_errlog.h>
+#include <npmx_vbusin.h>
+#include <zephyr/settings/settings.h>
 #include <zephyr/logging/log.h>
 
 #define LOG_MODULE_NAME pmic_charger
 LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+APP_LOG_BUCKET_DEFINE(CONFIG_APP_LOG_RATE_PER_SEC, CONFIG_APP_LOG_RATE_BURST);
 
 static app_pmic_callback_t m_callback;
 
@@ -19,6 +24,51 @@ static npmx_buck_t *m_bucks[2];
 
 static uint16_t m_battery_voltage_mv = 0;
 
+static npmx_instance_t *m_npmx_instance;
+
+#define CHARGE_CURRENT_MIN_MA	32
+#define CHARGE_CURRENT_MAX_MA	800
+
+/* A reduced current below the charger minimum would be clamped back up to it, and not be reduced at all.
+ * 0 % suspends charging instead, which works for any current. */
+#define CHARGE_CURRENT_REDUCIBLE(ma, percent) ((percent) == 0 || (ma) * (percent) / 100 >= CHARGE_CURRENT_MIN_MA)
+#define CHARGE_CURRENT_VALID(ma) ((ma) >= CHARGE_CURRENT_MIN_MA && (ma) <= CHARGE_CURRENT_MAX_MA && \
+								  CHARGE_CURRENT_REDUCIBLE(ma, CONFIG_CHARGE_PROFILE_COOL_CURRENT_PERCENT) && \
+								  CHARGE_CURRENT_REDUCIBLE(ma, CONFIG_CHARGE_PROFILE_WARM_CURRENT_PERCENT))
+
+BUILD_ASSERT(CHARGE_CURRENT_VALID(CONFIG_CHARGING_CURRENT),
+			 "Charging current too low to be reduced in the cool and warm zones");
+
+#define CHARGER_MODULES_ENABLED (NPMX_CHARGER_MODULE_CHARGER_MASK | \
+								 NPMX_CHARGER_MODULE_RECHARGE_MASK | \
+								 NPMX_CHARGER_MODULE_NTC_LIMITS_MASK)
+
+/* Termination voltages supported by the charger, in ascending order. */
+static const uint16_t m_term_voltages_mv[] = {3500, 3550, 3600, 3650, 4000, 4050, 4100,
+											  4150, 4200, 4250, 4300, 4350, 4400, 4450};
+
+static app_pmic_charge_profile_t m_charge_profile = {
+	.charge_current_ma = CONFIG_CHARGING_CURRENT,
+	.term_voltage_mv = CONFIG_TERMINATION_VOLTAGE,
+};
+
+/* Inputs to the charge profile engine, and the charger settings last applied. */
+static struct {
+	app_pmic_temp_zone_t temp_zone;
+	int16_t temperature;
+	uint16_t vbus_limit_ma;
+	bool vbus_present;
+	bool charging_completed;
+	bool applied;
+	uint16_t applied_current_ma;
+	uint16_t applied_term_voltage_mv;
+} m_charge;
+
+K_MUTEX_DEFINE(m_charge_mutex);
+
+static void charge_profile_work_handler(struct k_work *work);
+K_WORK_DEFINE(m_charge_profile_work, charge_profile_work_handler);
+
 /** @brief Possible events from requested nPM device. */
 typedef enum {
 	APP_CHARGER_EVENT_BATTERY_DETECTED, /** Event registered when battery connection detected. */
@@ -44,6 +94,13 @@ const char *pmic_state_name_strings[] =  {"Battery Detected",
 									"Bat Low Alert 1", 
 									"Bat Low Alert 2"};
 
+const char *pmic_temp_zone_name_strings[] = {"Unknown",
+											 "Cold",
+											 "Cool",
+											 "Normal",
+											 "Warm",
+											 "Hot"};
+
 /**
  * @brief Register the new event received from nPM device.
  *
@@ -52,39 +109,9 @@ const char *pmic_state_name_strings[] =  {"Battery Detected",
 static void register_state_change(npm1300_charger_event_t event)
 {
 	static app_pmic_evt_t app_event;
-	switch(event) {
-		case APP_CHARGER_EVENT_BATTERY_DETECTED:
-			LOG_INF("0 APP_CHARGER_EVENT_BATTERY_DETECTED");
-			break;
-		case APP_CHARGER_EVENT_BATTERY_REMOVED:
-			LOG_INF("1 APP_CHARGER_EVENT_BATTERY_REMOVED");
-			break;
-		case APP_CHARGER_EVENT_VBUS_DETECTED: 
-			LOG_INF("2 APP_CHARGER_EVENT_VBUS_DETECTED");
-			break;
-		case APP_CHARGER_EVENT_VBUS_REMOVED: 
-			LOG_INF("3 APP_CHARGER_EVENT_VBUS_REMOVED");
-			break;
-		case APP_CHARGER_EVENT_CHARGING_TRICKE_STARTED: 
-			LOG_INF("4 APP_CHARGER_EVENT_CHARGING_TRICKE_STARTED");
-			break; 
-		case APP_CHARGER_EVENT_CHARGING_CC_STARTED:
-			LOG_INF("5 APP_CHARGER_EVENT_CHARGING_CC_STARTED");
-			break;
-		case APP_CHARGER_EVENT_CHARGING_CV_STARTED:
-			LOG_INF("6 APP_CHARGER_EVENT_CHARGING_CV_STARTED");
-			break;
-		case APP_CHARGER_EVENT_CHARGING_COMPLETED:
-			LOG_INF("7 APP_CHARGER_EVENT_CHARGING_COMPLETED");
-			break;
-		case APP_CHARGER_EVENT_BATTERY_LOW_ALERT1:
-			LOG_INF("8 APP_CHARGER_EVENT_BATTERY_LOW_ALERT1");
-			break;
-		case APP_CHARGER_EVENT_BATTERY_LOW_ALERT2:
-		default:
-			LOG_INF("event %i", event);
-			break;
-	}
+
+	APP_LOG_INF("%d %s", event, pmic_state_name_strings[event]);
+
 	app_event.type = event;
 	m_callback(&app_event);
 }
@@ -108,6 +135,198 @@ static void set_buck_voltage(npmx_buck_t *p_buck, npmx_buck_voltage_t voltage)
 	}
 }
 
+/**
+ * @brief Function for reading a measurement or status from the nPM device.
+ *
+ * Reads are recorded when capturing an event trace, and served from the trace when replaying one.
+ *
+ * @param[in]  p_pm  The pointer to the instance of nPM device.
+ * @param[in]  kind  What to read.
+ * @param[out] value The value read.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+static int pmic_read(npmx_instance_t *p_pm, app_trace_kind_t kind, uint16_t *value)
+{
+#if defined(CONFIG_APP_EVENT_TRACE_REPLAY)
+	return app_trace_replay_read(kind, value);
+#else
+	npmx_error_t err;
+
+	switch (kind) {
+		case APP_TRACE_READ_VBAT:
+			err = npmx_adc_meas_get(npmx_adc_get(p_pm, 0), NPMX_ADC_MEAS_VBAT, value);
+			break;
+		case APP_TRACE_READ_BAT_TEMP:
+			err = npmx_adc_meas_get(npmx_adc_get(p_pm, 0), NPMX_ADC_MEAS_BAT_TEMP, value);
+			break;
+		case APP_TRACE_READ_CHARGER_STATUS: {
+			npmx_charger_status_mask_t status;
+			err = npmx_charger_status_get(npmx_charger_get(p_pm, 0), &status);
+			*value = (uint16_t)status;
+			break;
+		}
+		case APP_TRACE_READ_VBUS_CC: {
+			npmx_vbusin_cc_t cc1, cc2;
+			err = npmx_vbusin_cc_status_get(npmx_vbusin_get(p_pm, 0), &cc1, &cc2);
+			*value = (uint16_t)(cc1 | (cc2 << 8));
+			break;
+		}
+		default:
+			return -EINVAL;
+	}
+
+	if (err != NPMX_SUCCESS) return -EIO;
+
+	app_trace_record_read(kind, *value);
+	return 0;
+#endif
+}
+
+BUILD_ASSERT(CONFIG_CHARGE_PROFILE_TEMP_COLD <= CONFIG_CHARGE_PROFILE_TEMP_COOL &&
+			 CONFIG_CHARGE_PROFILE_TEMP_COOL <= CONFIG_CHARGE_PROFILE_TEMP_WARM &&
+			 CONFIG_CHARGE_PROFILE_TEMP_WARM <= CONFIG_CHARGE_PROFILE_TEMP_HOT,
+			 "Charge profile temperature limits must be in ascending order");
+
+/* A zone must be wider than the hysteresis, or leaving a neighbouring zone could skip past it. Zones can
+ * be left out by giving both limits the same value. */
+#define TEMP_ZONE_WIDTH_VALID(lower, upper) \
+	((upper) == (lower) || (upper) - (lower) > CONFIG_CHARGE_PROFILE_TEMP_HYSTERESIS)
+
+BUILD_ASSERT(TEMP_ZONE_WIDTH_VALID(CONFIG_CHARGE_PROFILE_TEMP_COLD, CONFIG_CHARGE_PROFILE_TEMP_COOL) &&
+			 TEMP_ZONE_WIDTH_VALID(CONFIG_CHARGE_PROFILE_TEMP_COOL, CONFIG_CHARGE_PROFILE_TEMP_WARM) &&
+			 TEMP_ZONE_WIDTH_VALID(CONFIG_CHARGE_PROFILE_TEMP_WARM, CONFIG_CHARGE_PROFILE_TEMP_HOT),
+			 "Charge profile temperature hysteresis must be smaller than every temperature zone");
+
+/**
+ * @brief Function for mapping a battery temperature to a charging temperature zone.
+ *
+ * @param[in] temperature Battery temperature [C].
+ *
+ * @return Temperature zone.
+ */
+static app_pmic_temp_zone_t temp_to_zone(int temperature)
+{
+	if (temperature < CONFIG_CHARGE_PROFILE_TEMP_COLD) return APP_PMIC_TEMP_ZONE_COLD;
+	if (temperature < CONFIG_CHARGE_PROFILE_TEMP_COOL) return APP_PMIC_TEMP_ZONE_COOL;
+	if (temperature <= CONFIG_CHARGE_PROFILE_TEMP_WARM) return APP_PMIC_TEMP_ZONE_NORMAL;
+	if (temperature <= CONFIG_CHARGE_PROFILE_TEMP_HOT) return APP_PMIC_TEMP_ZONE_WARM;
+	return APP_PMIC_TEMP_ZONE_HOT;
+}
+
+/**
+ * @brief Function for updating the charging temperature zone from a new NTC reading.
+ *
+ * Leaving the current zone requires the temperature to cross the zone limit by
+ * CONFIG_CHARGE_PROFILE_TEMP_HYSTERESIS, so the charger is not toggled on every reading
+ * while the battery sits right at a limit.
+ *
+ * @param[in] temperature Battery temperature [C].
+ */
+static void charge_temperature_update(int16_t temperature)
+{
+	app_pmic_temp_zone_t zone = temp_to_zone(temperature);
+
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+	m_charge.temperature = temperature;
+	if (m_charge.temp_zone != APP_PMIC_TEMP_ZONE_UNKNOWN) {
+		if (zone > m_charge.temp_zone) {
+			zone = temp_to_zone(temperature - CONFIG_CHARGE_PROFILE_TEMP_HYSTERESIS);
+		} else if (zone < m_charge.temp_zone) {
+			zone = temp_to_zone(temperature + CONFIG_CHARGE_PROFILE_TEMP_HYSTERESIS);
+		}
+	}
+	if (zone != m_charge.temp_zone) {
+		LOG_INF("Battery temperature %d C, zone %s", temperature, pmic_temp_zone_name_strings[zone]);
+		m_charge.temp_zone = zone;
+		k_work_submit(&m_charge_profile_work);
+	}
+	k_mutex_unlock(&m_charge_mutex);
+}
+
+/* The nPM1300 VBUS current limit is 100 mA, or 500 mA to 1500 mA in 100 mA steps. */
+#define VBUS_CURRENT_LIMIT_VALID(ma) ((ma) == 100 || ((ma) >= 500 && (ma) <= 1500 && (ma) % 100 == 0))
+
+BUILD_ASSERT(VBUS_CURRENT_LIMIT_VALID(CONFIG_CHARGE_PROFILE_VBUS_DEFAULT_LIMIT),
+			 "Unsupported default VBUS current limit");
+BUILD_ASSERT(VBUS_CURRENT_LIMIT_VALID(CONFIG_CHARGE_PROFILE_VBUS_HIGH_POWER_LIMIT),
+			 "Unsupported high power VBUS current limit");
+
+/**
+ * @brief Function for returning VBUS current limit enum associated with given current.
+ *
+ * @param[in] ma Current to be translated.
+ *
+ * @return VBUS current limit enum.
+ */
+static npmx_vbusin_current_t ma_to_vbusin_current_enum(uint16_t ma)
+{
+	switch (ma) {
+	case 100:
+		return NPMX_VBUSIN_CURRENT_100_MA;
+	case 500:
+		return NPMX_VBUSIN_CURRENT_500_MA;
+	case 600:
+		return NPMX_VBUSIN_CURRENT_600_MA;
+	case 700:
+		return NPMX_VBUSIN_CURRENT_700_MA;
+	case 800:
+		return NPMX_VBUSIN_CURRENT_800_MA;
+	case 900:
+		return NPMX_VBUSIN_CURRENT_900_MA;
+	case 1000:
+		return NPMX_VBUSIN_CURRENT_1000_MA;
+	case 1100:
+		return NPMX_VBUSIN_CURRENT_1100_MA;
+	case 1200:
+		return NPMX_VBUSIN_CURRENT_1200_MA;
+	case 1300:
+		return NPMX_VBUSIN_CURRENT_1300_MA;
+	case 1400:
+		return NPMX_VBUSIN_CURRENT_1400_MA;
+	case 1500:
+		return NPMX_VBUSIN_CURRENT_1500_MA;
+	default:
+		__ASSERT(false, "Invalid mA value to translate into VBUS current limit enum");
+		return NPMX_VBUSIN_CURRENT_100_MA;
+	}
+}
+
+/**
+ * @brief Function for setting the VBUS input current limit according to the connected USB source.
+ *
+ * @param[in] p_pm The pointer to the instance of nPM device.
+ *
+ * @return The VBUS current limit in mA.
+ */
+static uint16_t vbus_current_limit_update(npmx_instance_t *p_pm)
+{
+	uint16_t limit_ma = CONFIG_CHARGE_PROFILE_VBUS_DEFAULT_LIMIT;
+	uint16_t cc_status;
+
+	if (pmic_read(p_pm, APP_TRACE_READ_VBUS_CC, &cc_status) == 0) {
+		npmx_vbusin_cc_t cc1 = (npmx_vbusin_cc_t)(cc_status & 0xFF);
+		npmx_vbusin_cc_t cc2 = (npmx_vbusin_cc_t)(cc_status >> 8);
+		if (cc1 == NPMX_VBUSIN_CC_HIGH_POWER_1A5 || cc1 == NPMX_VBUSIN_CC_HIGH_POWER_3A0 ||
+		    cc2 == NPMX_VBUSIN_CC_HIGH_POWER_1A5 || cc2 == NPMX_VBUSIN_CC_HIGH_POWER_3A0) {
+			limit_ma = CONFIG_CHARGE_PROFILE_VBUS_HIGH_POWER_LIMIT;
+		}
+	}
+
+	LOG_INF("VBUS current limit %d mA", limit_ma);
+
+	if (IS_ENABLED(CONFIG_APP_EVENT_TRACE_REPLAY)) return limit_ma;
+
+	npmx_vbusin_t *vbusin_instance = npmx_vbusin_get(p_pm, 0);
+
+	if (npmx_vbusin_current_limit_set(vbusin_instance, ma_to_vbusin_current_enum(limit_ma)) != NPMX_SUCCESS ||
+	    npmx_vbusin_task_trigger(vbusin_instance, NPMX_VBUSIN_TASK_APPLY_CURRENT_LIMIT) != NPMX_SUCCESS) {
+		LOG_ERR("Unable to set VBUS current limit");
+	}
+
+	return limit_ma;
+}
+
 /**
  * @brief Function callback for vbusin events.
  *
@@ -117,10 +336,32 @@ static void set_buck_voltage(npmx_buck_t *p_buck, npmx_buck_voltage_t voltage)
  */
 static void vbusin_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8_t mask)
 {
+	app_trace_record_callback(APP_TRACE_SRC_VBUSIN, type, mask);
+
 	if (mask & (uint8_t)NPMX_EVENT_GROUP_VBUSIN_DETECTED_MASK) {
+		uint16_t vbus_limit_ma = vbus_current_limit_update(p_pm);
+
+		k_mutex_lock(&m_charge_mutex, K_FOREVER);
+		m_charge.vbus_present = true;
+		m_charge.vbus_limit_ma = vbus_limit_ma;
+		k_mutex_unlock(&m_charge_mutex);
+		k_work_submit(&m_charge_profile_work);
+
+		/* Get a fresh temperature reading before charging gets going. */
+		if (!IS_ENABLED(CONFIG_APP_EVENT_TRACE_REPLAY)) {
+			npmx_adc_task_trigger(npmx_adc_get(p_pm, 0), NPMX_ADC_TASK_SINGLE_SHOT_NTC);
+		}
+
 		register_state_change(APP_CHARGER_EVENT_VBUS_DETECTED);
 	}
 	else if (mask & (uint8_t)NPMX_EVENT_GROUP_VBUSIN_REMOVED_MASK) {
+		k_mutex_lock(&m_charge_mutex, K_FOREVER);
+		m_charge.vbus_present = false;
+		m_charge.vbus_limit_ma = 0;
+		m_charge.charging_completed = false;
+		k_mutex_unlock(&m_charge_mutex);
+		k_work_submit(&m_charge_profile_work);
+
 		register_state_change(APP_CHARGER_EVENT_VBUS_REMOVED);
 	}
 	else LOG_WRN("Unhandled vbusin callback reveived!");
@@ -135,13 +376,14 @@ static void vbusin_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, ui
  */
 static void adc_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8_t mask)
 {
+	app_trace_record_callback(APP_TRACE_SRC_ADC, type, mask);
+
 	if ((mask & (uint8_t)NPMX_EVENT_GROUP_ADC_BAT_READY_MASK)) {
 		static uint16_t battery_voltage_millivolts_last = 0;
-		if (npmx_adc_meas_get(npmx_adc_get(p_pm, 0), NPMX_ADC_MEAS_VBAT,
-				      &m_battery_voltage_mv) == NPMX_SUCCESS) {
+		if (pmic_read(p_pm, APP_TRACE_READ_VBAT, &m_battery_voltage_mv) == 0) {
 			if (m_battery_voltage_mv != battery_voltage_millivolts_last) {
 				battery_voltage_millivolts_last = m_battery_voltage_mv;
-				LOG_INF("Battery:\t %d mV", m_battery_voltage_mv);
+				APP_LOG_INF("Battery:\t %d mV", m_battery_voltage_mv);
 			}
 			if (m_battery_voltage_mv < CONFIG_BATTERY_VOLTAGE_THRESHOLD_2) {
 				register_state_change(APP_CHARGER_EVENT_BATTERY_LOW_ALERT2);
@@ -150,6 +392,22 @@ static void adc_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8
 				register_state_change(APP_CHARGER_EVENT_BATTERY_LOW_ALERT1);
 			}
 		}
+
+		/* Track the battery temperature while VBUS is present, piggybacking on the VBAT interval. */
+		k_mutex_lock(&m_charge_mutex, K_FOREVER);
+		bool vbus_present = m_charge.vbus_present;
+		k_mutex_unlock(&m_charge_mutex);
+
+		if (vbus_present && !IS_ENABLED(CONFIG_APP_EVENT_TRACE_REPLAY)) {
+			npmx_adc_task_trigger(npmx_adc_get(p_pm, 0), NPMX_ADC_TASK_SINGLE_SHOT_NTC);
+		}
+	}
+
+	if ((mask & (uint8_t)NPMX_EVENT_GROUP_ADC_NTC_READY_MASK)) {
+		uint16_t temperature;
+		if (pmic_read(p_pm, APP_TRACE_READ_BAT_TEMP, &temperature) == 0) {
+			charge_temperature_update((int16_t)temperature);
+		}
 	}
 }
 
@@ -162,19 +420,24 @@ static void adc_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8
  */
 static void charger_status_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8_t mask)
 {
-	npmx_charger_t *charger_instance = npmx_charger_get(p_pm, 0);
+	app_trace_record_callback(APP_TRACE_SRC_CHARGER_STATUS, type, mask);
 
-	if (mask & (uint8_t)NPMX_EVENT_GROUP_CHARGER_ERROR_MASK) {
+	if ((mask & (uint8_t)NPMX_EVENT_GROUP_CHARGER_ERROR_MASK) && !IS_ENABLED(CONFIG_APP_EVENT_TRACE_REPLAY)) {
 		/* Check charger errors and run default debug callbacks to log error bits. */
-		npmx_charger_errors_check(charger_instance);
+		npmx_charger_errors_check(npmx_charger_get(p_pm, 0));
 	}
 
-	npmx_charger_status_mask_t status;
+	uint16_t status;
 
 	/* Delay required for status stabilization. */
 	k_msleep(5);
 
-	if (npmx_charger_status_get(charger_instance, &status) == NPMX_SUCCESS) {
+	if (pmic_read(p_pm, APP_TRACE_READ_CHARGER_STATUS, &status) == 0) {
+		k_mutex_lock(&m_charge_mutex, K_FOREVER);
+		m_charge.charging_completed = (status & NPMX_CHARGER_STATUS_COMPLETED_MASK) != 0;
+		k_mutex_unlock(&m_charge_mutex);
+		k_work_submit(&m_charge_profile_work);
+
 		if (status & NPMX_CHARGER_STATUS_TRICKLE_CHARGE_MASK) {
 			register_state_change(APP_CHARGER_EVENT_CHARGING_TRICKE_STARTED);
 		}
@@ -200,6 +463,8 @@ static void charger_status_callback(npmx_instance_t *p_pm, npmx_callback_type_t
  */
 static void charger_battery_callback(npmx_instance_t *p_pm, npmx_callback_type_t type, uint8_t mask)
 {
+	app_trace_record_callback(APP_TRACE_SRC_CHARGER_BATTERY, type, mask);
+
 	if (mask & (uint8_t)NPMX_EVENT_GROUP_BATTERY_DETECTED_MASK) {
 		register_state_change(APP_CHARGER_EVENT_BATTERY_DETECTED);
 	}
@@ -253,8 +518,252 @@ static npmx_charger_voltage_t mv_to_charger_voltage_enum(uint32_t mv)
 	}
 }
 
+/**
+ * @brief Function for checking that a charge profile can be applied to the charger.
+ *
+ * @param[in] profile Charge profile to check.
+ *
+ * @return 0 if valid, -EINVAL otherwise.
+ */
+static int charge_profile_validate(const app_pmic_charge_profile_t *profile)
+{
+	if (!CHARGE_CURRENT_VALID(profile->charge_current_ma)) return -EINVAL;
+	for (int i = 0; i < ARRAY_SIZE(m_term_voltages_mv); i++) {
+		if (m_term_voltages_mv[i] == profile->term_voltage_mv) return 0;
+	}
+	return -EINVAL;
+}
+
+/**
+ * @brief Function for finding the highest supported termination voltage at or below a given voltage.
+ *
+ * @param[in] mv Upper bound for the termination voltage.
+ *
+ * @return Supported termination voltage, or the lowest supported one if none is at or below @p mv.
+ */
+static uint16_t term_voltage_floor(int mv)
+{
+	for (int i = ARRAY_SIZE(m_term_voltages_mv) - 1; i > 0; i--) {
+		if (m_term_voltages_mv[i] <= mv) return m_term_voltages_mv[i];
+	}
+	return m_term_voltages_mv[0];
+}
+
+/**
+ * @brief Function for computing the charger settings from the profile and the current conditions.
+ *
+ * Must be called with m_charge_mutex held.
+ *
+ * @param[out] current_ma Charge current, or 0 if charging should be suspended.
+ * @param[out] term_mv    Termination voltage.
+ */
+static void charge_profile_target_get(uint16_t *current_ma, uint16_t *term_mv)
+{
+	uint32_t current = m_charge_profile.charge_current_ma;
+	uint16_t term = m_charge_profile.term_voltage_mv;
+
+	switch (m_charge.temp_zone) {
+		case APP_PMIC_TEMP_ZONE_COLD:
+		case APP_PMIC_TEMP_ZONE_HOT:
+			current = 0;
+			break;
+		case APP_PMIC_TEMP_ZONE_UNKNOWN:
+			/* No NTC reading yet, stay on the safe side until there is one. */
+		case APP_PMIC_TEMP_ZONE_COOL:
+			current = current * CONFIG_CHARGE_PROFILE_COOL_CURRENT_PERCENT / 100;
+			break;
+		case APP_PMIC_TEMP_ZONE_WARM:
+			current = current * CONFIG_CHARGE_PROFILE_WARM_CURRENT_PERCENT / 100;
+			term = term_voltage_floor(term - CONFIG_CHARGE_PROFILE_WARM_TERM_VOLTAGE_DROP);
+			break;
+		case APP_PMIC_TEMP_ZONE_NORMAL:
+		default:
+			break;
+	}
+
+	if (m_charge.vbus_limit_ma != 0 && current > m_charge.vbus_limit_ma) {
+		current = m_charge.vbus_limit_ma;
+	}
+
+	/* The charger current is set in 2 mA steps. */
+	if (current != 0) {
+		current = CLAMP(current & ~1UL, CHARGE_CURRENT_MIN_MA, CHARGE_CURRENT_MAX_MA);
+	}
+
+	*current_ma = current;
+	*term_mv = term;
+}
+
+/**
+ * @brief Function for writing charge current and termination voltage to the charger.
+ *
+ * The charger has to be disabled while these are changed, and is left disabled if
+ * @p current_ma is 0.
+ *
+ * @param[in] current_ma Charge current, or 0 to suspend charging.
+ * @param[in] term_mv    Termination voltage.
+ *
+ * @return 0 on success, -EIO if the charger could not be disabled.
+ */
+static int charger_write(uint16_t current_ma, uint16_t term_mv)
+{
+	npmx_charger_t *charger_instance = npmx_charger_get(m_npmx_instance, 0);
+
+	/* Disable charger before changing charge current */
+	if (npmx_charger_module_disable_set(charger_instance, NPMX_CHARGER_MODULE_CHARGER_MASK) != NPMX_SUCCESS) {
+		LOG_ERR("Unable to disable charger");
+		return -EIO;
+	}
+
+	if (current_ma == 0) return 0;
+
+	/* Set charging current. */
+	if (npmx_charger_charging_current_set(charger_instance, current_ma) != NPMX_SUCCESS) {
+		LOG_ERR("Unable to set charging current");
+	}
+
+	/* Set battery termination voltage. */
+	if (npmx_charger_termination_voltage_normal_set(
+			charger_instance, mv_to_charger_voltage_enum(term_mv)) != NPMX_SUCCESS) {
+		LOG_ERR("Unable to set termination voltage");
+	}
+
+	/* Enable charger for events handling. */
+	if (npmx_charger_module_enable_set(charger_instance, CHARGER_MODULES_ENABLED) != NPMX_SUCCESS) {
+		LOG_ERR("Unable to enable charger");
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Function for applying new charger settings, and keeping track of what is applied.
+ *
+ * When replaying an event trace there is no charger, and only the bookkeeping is done.
+ *
+ * @param[in] current_ma Charge current, or 0 to suspend charging.
+ * @param[in] term_mv    Termination voltage.
+ */
+static void charge_profile_apply(uint16_t current_ma, uint16_t term_mv)
+{
+	if (!IS_ENABLED(CONFIG_APP_EVENT_TRACE_REPLAY) && charger_write(current_ma, term_mv) < 0) {
+		return;
+	}
+
+	if (current_ma == 0) {
+		LOG_INF("Charging suspended");
+	} else {
+		LOG_INF("Charging at %d mA, termination %d mV", current_ma, term_mv);
+	}
+
+	m_charge.applied = true;
+	m_charge.applied_current_ma = current_ma;
+	m_charge.applied_term_voltage_mv = term_mv;
+}
+
+/**
+ * @brief Function for applying the charge profile at startup, before any event has been received.
+ */
+static void charge_profile_apply_initial(void)
+{
+	uint16_t current_ma, term_mv;
+
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+	charge_profile_target_get(&current_ma, &term_mv);
+	charge_profile_apply(current_ma, term_mv);
+	k_mutex_unlock(&m_charge_mutex);
+}
+
+/**
+ * @brief Work handler re-evaluating the charge profile whenever one of its inputs changes.
+ *
+ * Runs in the system work queue, so that the charger is only ever reconfigured from one context.
+ */
+static void charge_profile_work_handler(struct k_work *work)
+{
+	uint16_t current_ma, term_mv;
+
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+
+	charge_profile_target_get(&current_ma, &term_mv);
+
+	if (m_charge.applied && current_ma == m_charge.applied_current_ma &&
+	    term_mv == m_charge.applied_term_voltage_mv) {
+		k_mutex_unlock(&m_charge_mutex);
+		return;
+	}
+
+	/* Re-enabling the charger after completion would restart the charge cycle, so while the
+	 * charger is enabled only suspending is applied right away. Anything else waits for the next cycle. */
+	if (m_charge.charging_completed && current_ma != 0 && m_charge.applied_current_ma != 0) {
+		LOG_DBG("Charging completed, deferring charge profile update");
+		k_mutex_unlock(&m_charge_mutex);
+		return;
+	}
+
+	/* No status events arrive while the charger is suspended, so the completed state can't be
+	 * cleared later. Forget it, charging resumes with a new cycle once conditions allow. */
+	if (current_ma == 0) {
+		m_charge.charging_completed = false;
+	}
+
+	charge_profile_apply(current_ma, term_mv);
+
+	k_mutex_unlock(&m_charge_mutex);
+}
+
+/**
+ * @brief Settings handler loading the stored charge profile.
+ */
+static int charge_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	const char *next;
+	app_pmic_charge_profile_t profile;
+	int ret;
+
+	if (settings_name_steq(name, "profile", &next) && !next) {
+		if (len != sizeof(profile)) return -EINVAL;
+
+		ret = read_cb(cb_arg, &profile, sizeof(profile));
+		if (ret < 0) return ret;
+
+		if (charge_profile_validate(&profile) != 0) {
+			LOG_WRN("Ignoring invalid stored charge profile");
+			return -EINVAL;
+		}
+
+		m_charge_profile = profile;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(charge, "charge", NULL, charge_settings_set, NULL, NULL);
+
 int app_pmic_init(app_pmic_callback_t callback)
 {
+	m_callback = callback;
+
+	/* Load the stored charge profile, if any. Build time defaults are used otherwise. */
+	if (settings_subsys_init() != 0 || settings_load_subtree("charge") != 0) {
+		LOG_WRN("Unable to load charge profile from flash");
+	}
+
+#if defined(CONFIG_APP_EVENT_TRACE_REPLAY)
+	/* No nPM device on a replay target, the recorded trace drives the event handlers instead. */
+	static const app_trace_handler_t trace_handlers[APP_TRACE_SRC_COUNT] = {
+		[APP_TRACE_SRC_VBUSIN] = vbusin_callback,
+		[APP_TRACE_SRC_ADC] = adc_callback,
+		[APP_TRACE_SRC_CHARGER_STATUS] = charger_status_callback,
+		[APP_TRACE_SRC_CHARGER_BATTERY] = charger_battery_callback,
+	};
+
+	charge_profile_apply_initial();
+
+	return app_trace_replay_start(trace_handlers);
+#endif
+
 	const struct device *pmic_dev = DEVICE_DT_GET(DT_NODELABEL(npm_0));
 
 	if (!device_is_ready(pmic_dev)) {
@@ -264,10 +773,9 @@ int app_pmic_init(app_pmic_callback_t callback)
 		LOG_INF("PMIC device ok");
 	}
 
-	m_callback = callback;
-
 	/* Get pointer to npmx device. */
 	npmx_instance_t *npmx_instance = &((struct npmx_data *)pmic_dev->data)->npmx_instance;
+	m_npmx_instance = npmx_instance;
 
 	/* Get a pointer to the two buck devices */
 	m_bucks[0] = npmx_buck_get(npmx_instance, 0);
@@ -276,9 +784,6 @@ int app_pmic_init(app_pmic_callback_t callback)
 	/* Get pointer to GPIO 0 instance. */
 	npmx_gpio_t *gpio_0 = npmx_gpio_get(npmx_instance, 0);
 
-	/* Get pointer to CHARGER instance. */
-	npmx_charger_t *charger_instance = npmx_charger_get(npmx_instance, 0);
-
 	/* Register callback for vbus events. */
 	npmx_core_register_cb(npmx_instance, vbusin_callback,
 			      NPMX_CALLBACK_TYPE_EVENT_VBUSIN_VOLTAGE);
@@ -300,21 +805,8 @@ int app_pmic_init(app_pmic_callback_t callback)
 	/* Use GPIO 0 as interrupt output. */
 	npmx_gpio_mode_set(gpio_0, NPMX_GPIO_MODE_OUTPUT_IRQ);
 
-	/* Disable charger before changing charge current */
-	npmx_charger_module_disable_set(charger_instance, NPMX_CHARGER_MODULE_CHARGER_MASK);
-
-	/* Set charging current. */
-	npmx_charger_charging_current_set(charger_instance, CONFIG_CHARGING_CURRENT);
-
-	/* Set battery termination voltage. */
-	npmx_charger_termination_voltage_normal_set(
-		charger_instance, mv_to_charger_voltage_enum(CONFIG_TERMINATION_VOLTAGE));
-
-	/* Enable charger for events handling. */
-	npmx_charger_module_enable_set(charger_instance,
-				       NPMX_CHARGER_MODULE_CHARGER_MASK |
-					       NPMX_CHARGER_MODULE_RECHARGE_MASK |
-					       NPMX_CHARGER_MODULE_NTC_LIMITS_MASK);
+	/* Apply the initial charge profile. It is re-evaluated as temperature and VBUS change. */
+	charge_profile_apply_initial();
 
 	/* Enable USB connections interrupts and events handling. */
 	npmx_core_event_interrupt_enable(npmx_instance, NPMX_EVENT_GROUP_VBUSIN_VOLTAGE,
@@ -336,7 +828,8 @@ int app_pmic_init(app_pmic_callback_t callback)
 
 	/* Enable ADC measurements ready interrupts. */
 	npmx_core_event_interrupt_enable(npmx_instance, NPMX_EVENT_GROUP_ADC,
-					 NPMX_EVENT_GROUP_ADC_BAT_READY_MASK);
+					 NPMX_EVENT_GROUP_ADC_BAT_READY_MASK |
+						 NPMX_EVENT_GROUP_ADC_NTC_READY_MASK);
 
 	/* Set NTC type for ADC measurements. */
 	npmx_adc_ntc_set(npmx_adc_get(npmx_instance, 0), NPMX_ADC_BATTERY_NTC_TYPE_10_K);
@@ -349,6 +842,21 @@ int app_pmic_init(app_pmic_callback_t callback)
 
 	npmx_adc_config_set(npmx_adc_get(npmx_instance, 0), &config);
 
+	/* Take a first temperature reading for the charge profile. */
+	npmx_adc_task_trigger(npmx_adc_get(npmx_instance, 0), NPMX_ADC_TASK_SINGLE_SHOT_NTC);
+
+	/* The nRF is powered by the nPM, so USB may have been plugged in before boot, in which case
+	 * no VBUS detected event will follow. Handle it the same way as if the event had arrived. */
+	npmx_vbusin_status_t vbus_status;
+	if (npmx_vbusin_vbus_status_get(npmx_vbusin_get(npmx_instance, 0), &vbus_status) == NPMX_SUCCESS) {
+		if (vbus_status & NPMX_VBUSIN_STATUS_CONNECTED_MASK) {
+			vbusin_callback(npmx_instance, NPMX_CALLBACK_TYPE_EVENT_VBUSIN_VOLTAGE,
+							(uint8_t)NPMX_EVENT_GROUP_VBUSIN_DETECTED_MASK);
+		}
+	} else {
+		LOG_ERR("Unable to read VBUS status");
+	}
+
 	return 0;
 }
 
@@ -365,6 +873,48 @@ int app_pmic_buck_out_enable(bool enable)
 int app_pmic_set_buck_out_voltage(int decivolt)
 {
 	if(decivolt < 10 || decivolt > 33) return -EINVAL;
+	/* Not set when replaying an event trace, there is no nPM to talk to. */
+	if (m_bucks[BUCK_OUT] == NULL) return -ENODEV;
 	set_buck_voltage(m_bucks[BUCK_OUT], (npmx_buck_voltage_t)(decivolt-10));
 	return 0;
 }
+
+int app_pmic_set_charge_profile(const app_pmic_charge_profile_t *profile)
+{
+	int ret;
+
+	ret = charge_profile_validate(profile);
+	if (ret < 0) return ret;
+
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+	m_charge_profile = *profile;
+	k_mutex_unlock(&m_charge_mutex);
+
+	k_work_submit(&m_charge_profile_work);
+
+	ret = settings_save_one("charge/profile", profile, sizeof(*profile));
+	if (ret < 0) {
+		LOG_ERR("Unable to store charge profile (err %d)", ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+void app_pmic_get_charge_profile(app_pmic_charge_profile_t *profile)
+{
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+	*profile = m_charge_profile;
+	k_mutex_unlock(&m_charge_mutex);
+}
+
+void app_pmic_get_charge_status(app_pmic_charge_status_t *status)
+{
+	k_mutex_lock(&m_charge_mutex, K_FOREVER);
+	status->temp_zone = m_charge.temp_zone;
+	status->temperature = m_charge.temperature;
+	status->vbus_limit_ma = m_charge.vbus_limit_ma;
+	status->charge_current_ma = m_charge.applied_current_ma;
+	status->term_voltage_mv = m_charge.applied_term_voltage_mv;
+	k_mutex_unlock(&m_charge_mutex);
+}
@@ -0,0 +1,290 @@
+#include <app_trace.h>
+#include <app_bluetooth.h>
+#include <app_mem.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zephyr/logging/log.h>
+
+#define LOG_MODULE_NAME app_trace
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#if defined(CONFIG_APP_EVENT_TRACE_RECORD)
+
+#define DUMP_FRAME_PAYLOAD_MAX	(NUS_STRING_LEN_MAX - sizeof(app_trace_frame_header_t))
+#define DUMP_SEND_TIMEOUT		K_MSEC(1000)
+
+static app_trace_record_t m_trace_records[CONFIG_APP_EVENT_TRACE_RECORD_COUNT];
+static uint16_t m_trace_record_count;
+static uint32_t m_trace_start_ms;
+static bool m_trace_recording = true;
+/* Number of records being dumped, taken when the dump is requested. */
+static uint16_t m_trace_dump_count;
+static bool m_trace_dumping;
+static struct k_spinlock m_trace_lock;
+static struct app_mem_watermark m_trace_records_wm = APP_MEM_WATERMARK_INIT("Trace buffer",
+	CONFIG_APP_EVENT_TRACE_RECORD_COUNT, "records");
+
+static void trace_dump_work_handler(struct k_work *work);
+K_WORK_DEFINE(m_trace_dump_work, trace_dump_work_handler);
+
+/**
+ * @brief Append a record to the trace. Recording stops once the buffer is full, so a capture
+ *        always holds the start of a sequence of events.
+ */
+static void trace_append(uint8_t kind, uint8_t mask, uint16_t value)
+{
+	k_spinlock_key_t key = k_spin_lock(&m_trace_lock);
+
+	if (m_trace_recording && m_trace_record_count < CONFIG_APP_EVENT_TRACE_RECORD_COUNT) {
+		app_trace_record_t *record = &m_trace_records[m_trace_record_count++];
+		record->timestamp = sys_cpu_to_le32(k_uptime_get_32() - m_trace_start_ms);
+		record->kind = kind;
+		record->mask = mask;
+		record->value = sys_cpu_to_le16(value);
+	}
+
+	k_spin_unlock(&m_trace_lock, key);
+
+	app_mem_watermark_update(&m_trace_records_wm, m_trace_record_count);
+}
+
+void app_trace_record_callback(app_trace_kind_t source, npmx_callback_type_t type, uint8_t mask)
+{
+	trace_append(source, mask, (uint16_t)type);
+}
+
+void app_trace_record_read(app_trace_kind_t kind, uint16_t value)
+{
+	trace_append(kind, 0, value);
+}
+
+int app_trace_record_start(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&m_trace_lock);
+
+	/* The records are sent straight from the buffer, so they can't be cleared until the dump is done. */
+	if (m_trace_dumping) {
+		k_spin_unlock(&m_trace_lock, key);
+		return -EBUSY;
+	}
+
+	m_trace_record_count = 0;
+	m_trace_start_ms = k_uptime_get_32();
+	m_trace_recording = true;
+
+	k_spin_unlock(&m_trace_lock, key);
+
+	LOG_INF("Trace capture started");
+	return 0;
+}
+
+/**
+ * @brief Copy part of the trace file, the header followed by the records, into a buffer.
+ */
+static void trace_file_read(const app_trace_header_t *header, size_t offset, uint8_t *buf, size_t len)
+{
+	if (offset < sizeof(*header)) {
+		size_t n = MIN(len, sizeof(*header) - offset);
+		memcpy(buf, (const uint8_t *)header + offset, n);
+		offset += n;
+		buf += n;
+		len -= n;
+	}
+	memcpy(buf, (const uint8_t *)m_trace_records + offset - sizeof(*header), len);
+}
+
+static void trace_dump_work_handler(struct k_work *work)
+{
+	static struct {
+		app_trace_frame_header_t header;
+		uint8_t payload[DUMP_FRAME_PAYLOAD_MAX];
+	} __packed frame = {
+		.header.prefix = APP_TRACE_FRAME_PREFIX,
+	};
+	app_trace_header_t header = {
+		.magic = sys_cpu_to_le32(APP_TRACE_MAGIC),
+		.version = APP_TRACE_VERSION,
+		.record_size = sizeof(app_trace_record_t),
+		.record_count = sys_cpu_to_le16(m_trace_dump_count),
+	};
+	size_t file_size = sizeof(header) + m_trace_dump_count * sizeof(app_trace_record_t);
+	uint16_t seq = 0;
+	k_spinlock_key_t key;
+
+	LOG_INF("Dumping %d trace records", m_trace_dump_count);
+
+	for (size_t offset = 0; offset < file_size; offset += frame.header.length) {
+		frame.header.seq = sys_cpu_to_le16(seq++);
+		frame.header.length = MIN(sizeof(frame.payload), file_size - offset);
+		trace_file_read(&header, offset, frame.payload, frame.header.length);
+
+		if (app_bt_send_timeout((uint8_t *)&frame, sizeof(frame.header) + frame.header.length,
+								DUMP_SEND_TIMEOUT) < 0) {
+			LOG_ERR("Trace dump failed");
+			break;
+		}
+	}
+
+	key = k_spin_lock(&m_trace_lock);
+	m_trace_dumping = false;
+	k_spin_unlock(&m_trace_lock, key);
+}
+
+int app_trace_dump(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&m_trace_lock);
+
+	if (m_trace_dumping) {
+		k_spin_unlock(&m_trace_lock, key);
+		return -EBUSY;
+	}
+
+	/* Freeze the capture, so the dump is consistent. Restart it with app_trace_record_start(). */
+	m_trace_recording = false;
+	m_trace_dump_count = m_trace_record_count;
+	m_trace_dumping = true;
+
+	k_spin_unlock(&m_trace_lock, key);
+
+	if (app_bt_bulk_work_submit(&m_trace_dump_work) < 0) {
+		key = k_spin_lock(&m_trace_lock);
+		m_trace_dumping = false;
+		k_spin_unlock(&m_trace_lock, key);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+#endif /* CONFIG_APP_EVENT_TRACE_RECORD */
+
+#if defined(CONFIG_APP_EVENT_TRACE_REPLAY)
+
+static const uint8_t m_trace_file[] = {
+#include "app_event_trace.inc"
+};
+
+static const app_trace_handler_t *m_replay_handlers;
+static uint16_t m_replay_record_count;
+static uint16_t m_replay_cursor;
+
+/* Statistics for the event being dispatched, and the replay as a whole. */
+static struct {
+	bool in_event;
+	uint32_t event_start_cycles;
+	uint32_t events;
+	uint32_t notifications;
+	uint32_t dropped;
+	uint32_t latency_min_us;
+	uint32_t latency_max_us;
+	uint64_t latency_sum_us;
+} m_replay_stats;
+
+static void trace_replay_thread_func(void);
+
+K_THREAD_DEFINE(m_trace_replay_thread, APP_TRACE_REPLAY_THREAD_STACKSIZE, trace_replay_thread_func,
+				NULL, NULL, NULL, APP_TRACE_REPLAY_THREAD_PRIORITY, 0, SYS_FOREVER_MS);
+
+static void trace_record_get(uint16_t index, app_trace_record_t *record)
+{
+	memcpy(record, &m_trace_file[sizeof(app_trace_header_t) + index * sizeof(app_trace_record_t)],
+		   sizeof(*record));
+	record->timestamp = sys_le32_to_cpu(record->timestamp);
+	record->value = sys_le16_to_cpu(record->value);
+}
+
+int app_trace_replay_start(const app_trace_handler_t handlers[APP_TRACE_SRC_COUNT])
+{
+	app_trace_header_t header;
+
+	if (sizeof(m_trace_file) < sizeof(header)) return -EINVAL;
+	memcpy(&header, m_trace_file, sizeof(header));
+
+	if (sys_le32_to_cpu(header.magic) != APP_TRACE_MAGIC || header.version != APP_TRACE_VERSION ||
+		header.record_size != sizeof(app_trace_record_t)) {
+		LOG_ERR("Invalid trace file");
+		return -EINVAL;
+	}
+
+	m_replay_record_count = sys_le16_to_cpu(header.record_count);
+	if (sizeof(m_trace_file) < sizeof(header) + m_replay_record_count * sizeof(app_trace_record_t)) {
+		LOG_ERR("Truncated trace file");
+		return -EINVAL;
+	}
+
+	m_replay_handlers = handlers;
+	m_replay_stats.latency_min_us = UINT32_MAX;
+
+	LOG_INF("Replaying %d trace records", m_replay_record_count);
+	k_thread_start(m_trace_replay_thread);
+	return 0;
+}
+
+int app_trace_replay_read(app_trace_kind_t kind, uint16_t *value)
+{
+	app_trace_record_t record;
+
+	if (m_replay_cursor >= m_replay_record_count) return -ENODATA;
+
+	trace_record_get(m_replay_cursor, &record);
+	if (record.kind != kind) return -ENODATA;
+
+	m_replay_cursor++;
+	*value = record.value;
+	return 0;
+}
+
+void app_trace_notification(int err)
+{
+	uint32_t latency_us;
+
+	/* Only count notifications raised by the handler of the event being replayed. */
+	if (!m_replay_stats.in_event || k_current_get() != m_trace_replay_thread) return;
+
+	if (err < 0) {
+		m_replay_stats.dropped++;
+		return;
+	}
+
+	latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - m_replay_stats.event_start_cycles);
+	m_replay_stats.notifications++;
+	m_replay_stats.latency_sum_us += latency_us;
+	m_replay_stats.latency_min_us = MIN(m_replay_stats.latency_min_us, latency_us);
+	m_replay_stats.latency_max_us = MAX(m_replay_stats.latency_max_us, latency_us);
+}
+
+static void trace_replay_thread_func(void)
+{
+	app_trace_record_t record;
+	uint32_t replay_start_ms = k_uptime_get_32();
+
+	while (m_replay_cursor < m_replay_record_count) {
+		trace_record_get(m_replay_cursor++, &record);
+
+		if (record.kind >= APP_TRACE_SRC_COUNT) {
+			LOG_WRN("Skipping unconsumed trace record (kind 0x%02x)", record.kind);
+			continue;
+		}
+
+#if CONFIG_APP_EVENT_TRACE_REPLAY_SPEEDUP > 0
+		/* Keep the recorded spacing between events, scaled down by the speedup factor. */
+		int32_t wait_ms = (int32_t)(replay_start_ms + record.timestamp / CONFIG_APP_EVENT_TRACE_REPLAY_SPEEDUP
+									- k_uptime_get_32());
+		if (wait_ms > 0) k_msleep(wait_ms);
+#endif
+
+		m_replay_stats.events++;
+		m_replay_stats.event_start_cycles = k_cycle_get_32();
+		m_replay_stats.in_event = true;
+		m_replay_handlers[record.kind](NULL, (npmx_callback_type_t)record.value, record.mask);
+		m_replay_stats.in_event = false;
+	}
+
+	LOG_INF("Replay done: %d events, %d notifications (%d dropped), latency min/avg/max %d/%d/%d us, %d ms",
+			m_replay_stats.events, m_replay_stats.notifications, m_replay_stats.dropped,
+			m_replay_stats.notifications ? m_replay_stats.latency_min_us : 0,
+			m_replay_stats.notifications ? (uint32_t)(m_replay_stats.latency_sum_us / m_replay_stats.notifications) : 0,
+			m_replay_stats.latency_max_us, k_uptime_get_32() - replay_start_ms);
+}
+
+#endif /* CONFIG_APP_EVENT_TRACE_REPLAY */
@@ -12,9 +12,13 @@
 #include <device.h>
 #include <zephyr.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <app_led.h>
 #include <app_pmic.h>
 #include <app_bluetooth.h>
+#include <app_trace.h>
+#include <app_log.h>
+#include <app_mem.h>
 #include <zephyr/sys/reboot.h>
 
 #include <zephyr/logging/log.h>
@@ -25,22 +29,114 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #define APP_BT_CMD_READ_BAT_VOLTAGE "Rbv"
 #define APP_BT_CMD_RESET			"Reset"
 #define APP_BT_CMD_SET_BUCK_VTG		"Setv"
+#define APP_BT_CMD_SET_CHG_CURRENT	"Setc"
+#define APP_BT_CMD_SET_CHG_TERM_VTG	"Sett"
+#define APP_BT_CMD_READ_CHG_PROFILE	"Rcp"
+#define APP_BT_CMD_START_TRACE		"Str"
+#define APP_BT_CMD_DUMP_TRACE		"Dtr"
+#define APP_BT_CMD_BLE_LOG			"Blog"
+#define APP_BT_CMD_MEM_REPORT		"Mem"
 #define IS_APP_BT_CMD(a, b) (strncmp(a, b, strlen(b)) == 0)
 
+#define MEM_REPORT_SEND_TIMEOUT		K_MSEC(1000)
+
+static struct app_mem_watermark m_bt_printf_wm = APP_MEM_WATERMARK_INIT("bt_printf buffer", NUS_STRING_LEN_MAX, "B");
+
+static void mem_report_work_handler(struct k_work *work);
+K_WORK_DEFINE(m_mem_report_work, mem_report_work_handler);
+
 void bt_printf(const char *str, ...)
 {
-	static uint8_t tmpstring[NUS_STRING_LEN_MAX];
+	static uint8_t tmpstring[NUS_STRING_LEN_MAX + 1];
 
     va_list myargs;
     va_start(myargs, str);
-	vsprintf(tmpstring, str, myargs);
+	int length = vsnprintf(tmpstring, sizeof(tmpstring), str, myargs);
     va_end(myargs);
 
-	if (app_bt_send(tmpstring, strlen(tmpstring)) < 0) {
+	if (length < 0) return;
+	if (length > NUS_STRING_LEN_MAX) {
+		/* Send the truncated string, and keep track of it so the buffer can be resized. */
+		app_mem_watermark_overflow(&m_bt_printf_wm);
+		length = NUS_STRING_LEN_MAX;
+	}
+	app_mem_watermark_update(&m_bt_printf_wm, length);
+
+	int err = app_bt_send(tmpstring, length);
+	if (err < 0) {
+		LOG_ERR("Unable to send data to the NUS service");
+	}
+	app_trace_notification(err);
+}
+
+/**
+ * @brief Parse the decimal argument following a command in an incoming NUS packet.
+ *
+ * @return The argument value, or -EINVAL if it is missing or malformed.
+ */
+static int parse_cmd_argument(app_bt_evt_t *bt_evt, const char *cmd)
+{
+	char arg[8];
+	char *end;
+	int arg_len = bt_evt->length - strlen(cmd);
+	long value;
+
+	if (arg_len <= 0 || arg_len >= sizeof(arg)) return -EINVAL;
+
+	memcpy(arg, bt_evt->buf + strlen(cmd), arg_len);
+	arg[arg_len] = 0;
+
+	value = strtol(arg, &end, 10);
+	if (end == arg || (*end != 0 && *end != '\r' && *end != '\n') || value < 0) return -EINVAL;
+
+	return (int)value;
+}
+
+static void update_charge_profile(int charge_current_ma, int term_voltage_mv)
+{
+	app_pmic_charge_profile_t profile;
+
+	/* Reject anything that doesn't fit the profile fields, rather than silently truncating it. */
+	if (charge_current_ma > UINT16_MAX || term_voltage_mv > UINT16_MAX) {
+		bt_printf("Invalid charge profile");
+		return;
+	}
+
+	app_pmic_get_charge_profile(&profile);
+	if (charge_current_ma >= 0) profile.charge_current_ma = charge_current_ma;
+	if (term_voltage_mv >= 0) profile.term_voltage_mv = term_voltage_mv;
+
+	switch (app_pmic_set_charge_profile(&profile)) {
+		case 0:
+			bt_printf("Charge profile: %i mA, %i mV", profile.charge_current_ma, profile.term_voltage_mv);
+			break;
+		case -EIO:
+			bt_printf("Charge profile: %i mA, %i mV, not stored", profile.charge_current_ma,
+					  profile.term_voltage_mv);
+			break;
+		default:
+			bt_printf("Invalid charge profile");
+			break;
+	}
+}
+
+static void mem_report_line(const char *line)
+{
+	LOG_DBG("%s", line);
+
+	if (app_bt_send_timeout((uint8_t *)line, strlen(line), MEM_REPORT_SEND_TIMEOUT) < 0) {
 		LOG_ERR("Unable to send data to the NUS service");
 	}
 }
 
+/**
+ * @brief Send the memory budget report, one NUS packet per line.
+ */
+static void mem_report_work_handler(struct k_work *work)
+{
+	app_mem_report(mem_report_line);
+}
+
 void pmic_callback(app_pmic_evt_t *evt)
 {
 	bt_printf("PMIC Evt: %s", pmic_state_name_strings[evt->type]);
@@ -57,6 +153,40 @@ void process_incoming_nus_data(app_bt_evt_t *bt_evt)
 					   (bt_evt->buf[strlen(APP_BT_CMD_SET_BUCK_VTG) + 1] - '0');
 		LOG_INF("Attempting to set buck out to %i decivolt", decivolt);
 		app_pmic_set_buck_out_voltage(decivolt);
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_SET_CHG_CURRENT)) {
+		int current_ma = parse_cmd_argument(bt_evt, APP_BT_CMD_SET_CHG_CURRENT);
+		LOG_INF("Attempting to set charge current to %i mA", current_ma);
+		if (current_ma < 0) bt_printf("Invalid charge current");
+		else update_charge_profile(current_ma, -1);
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_SET_CHG_TERM_VTG)) {
+		int term_mv = parse_cmd_argument(bt_evt, APP_BT_CMD_SET_CHG_TERM_VTG);
+		LOG_INF("Attempting to set termination voltage to %i mV", term_mv);
+		if (term_mv < 0) bt_printf("Invalid termination voltage");
+		else update_charge_profile(-1, term_mv);
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_READ_CHG_PROFILE)) {
+		app_pmic_charge_profile_t profile;
+		app_pmic_charge_status_t status;
+		app_pmic_get_charge_profile(&profile);
+		app_pmic_get_charge_status(&status);
+		bt_printf("Profile: %i mA, %i mV", profile.charge_current_ma, profile.term_voltage_mv);
+		bt_printf("Active: %i mA, %i mV, %s %i C, VBUS %i mA", status.charge_current_ma,
+				  status.term_voltage_mv, pmic_temp_zone_name_strings[status.temp_zone],
+				  status.temperature, status.vbus_limit_ma);
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_START_TRACE)) {
+		int err = app_trace_record_start();
+		if (err == -ENOTSUP) bt_printf("Trace capture not enabled");
+		else if (err == -EBUSY) bt_printf("Trace dump in progress");
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_DUMP_TRACE)) {
+		int err = app_trace_dump();
+		if (err == -ENOTSUP) bt_printf("Trace capture not enabled");
+		else if (err == -EBUSY) bt_printf("Trace dump in progress");
+		else if (err < 0) bt_printf("Trace dump failed");
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_BLE_LOG)) {
+		int enable = parse_cmd_argument(bt_evt, APP_BT_CMD_BLE_LOG);
+		if (enable < 0 || app_log_backend_ble_enable(enable != 0) < 0) bt_printf("BLE log backend not available");
+	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_MEM_REPORT)) {
+		if (IS_ENABLED(CONFIG_APP_MEM_BUDGET)) app_bt_bulk_work_submit(&m_mem_report_work);
+		else bt_printf("Memory budget report not enabled");
 	} else if (IS_APP_BT_CMD(bt_evt->buf, APP_BT_CMD_RESET)) {
 		LOG_INF("Resetting....");
 		k_msleep(50);